@@ -0,0 +1,50 @@
+#include "../src/output.cpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+// lines per second of the output pipeline against iostream
+// build with -DCMAKE_BUILD_TYPE=Release, then run each mode in its own process:
+//   for mode in iostream_sync iostream output binary; do output_bench $mode > file; done
+// results go to stderr so stdout can be pointed at a file or /dev/null
+
+static const std::string modes[] = {"iostream_sync", "iostream", "output", "binary"};
+
+static void run(const std::string &mode, int lines) {
+    if (mode == "iostream_sync" || mode == "iostream") {
+        for (int i = 0; i < lines; i++) {
+            std::cout << "P" << i << " = [" << i * 0.5 << ", " << i * 0.25 << ", " << i << "]\n";
+        }
+        std::cout.flush();
+    } else {
+        output::set_mode(mode == "binary" ? output::outmode::binary : output::outmode::text);
+        output::Buffer &out = output::buffer();
+        for (int i = 0; i < lines; i++) {
+            if (mode == "binary") {
+                out.point(i * 0.5, i * 0.25, i);
+            } else {
+                out << "P" << i << " = [" << i * 0.5 << ", " << i * 0.25 << ", " << i << "]\n";
+            }
+        }
+        output::flush();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (std::find(std::begin(modes), std::end(modes), mode) == std::end(modes)) {
+        std::fprintf(stderr, "usage: output_bench <iostream_sync|iostream|output|binary> [lines]\n");
+        return 1;
+    }
+    int lines = argc > 2 ? std::stoi(argv[2]) : 5000000;
+
+    // must happen before any I/O on the standard streams
+    std::ios::sync_with_stdio(mode == "iostream_sync");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    run(mode, lines);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "%-14s %8.2f M lines/s\n", mode.c_str(), lines / seconds / 1e6);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include "string_with_arrows.cpp"
 #include "token.cpp"
+#include "output.cpp"
 #pragma once
 
 enum class errortype {
@@ -17,7 +18,8 @@ class ErrorIllegalChar {
     ErrorIllegalChar(Position current_token_, std::string details_) : current_token(current_token_), details(details_) {}
 
     inline void display() {
-        std::cout << "ILLEGAL CHARACTER: " << details << " AT LINE: " << current_token.line << " COLUMN: " << current_token.col << "\n";
+        output::buffer() << "ILLEGAL CHARACTER: " << details << " AT LINE: " << current_token.line << " COLUMN: " << current_token.col << "\n";
+        output::flush();
     }
 };
 
@@ -31,9 +33,11 @@ class ErrorSyntax {
     ErrorSyntax(Token_ pos_, const std::string &details_) : pos(pos_), details(details_) {}
 
     inline void display() {
-        std::cout << "ERROR OCCURED AT [" << pos.x << ", " << pos.y << ", " << pos.z << "]\n:";
-        std::cout << "\t" << parser_arrows(pos) << "\n";
-        std::cout << "SYNTAX ERROR: " << details;
+        output::Buffer &out = output::buffer();
+        out << "ERROR OCCURED AT LINE: " << pos.posStart.line << " COLUMN: " << pos.posStart.col << "\n";
+        out << token_arrows(pos.posStart.fileTxt, pos);
+        out << "SYNTAX ERROR: " << details << "\n";
+        output::flush();
     }
 
     inline bool isEmpty() const {
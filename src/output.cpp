@@ -0,0 +1,693 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+// buffered output for PRINT, display! and diagnostics
+//
+// every thread appends into its own buffer. finished buffers are handed to a
+// background writer through a lock-free single producer / single consumer
+// ring, and the writer is woken through an atomic wait / notify, so printing
+// and handing off never take a lock. the writer drains all rings and emits
+// them with large batched writes. buffers are only handed off
+// at record boundaries (a finished line or binary record), so output from one
+// thread always comes out whole and in the order it was written.
+//
+// latency: a finished record is handed off as soon as the buffer fills, or
+// once `latency` has passed since the thread's last handoff. a record finished
+// after a quiet period therefore goes out right away; records finished shortly
+// after are held until the next record past the bound, end_tick() or flush().
+// the bound only holds for a program whose driver calls end_tick() once per
+// tick, or before it blocks (e.g. on input). nothing in the tree does that
+// yet: the interpreter has to add the call when its run loop exists.
+//
+// ordering between threads, and against std::cout, is not defined. call
+// flush() before another thread or stream has to print after this one.
+//
+// the writer is never destroyed. it is drained and stopped at exit, after
+// which every handoff is written synchronously by the calling thread under a
+// mutex. output
+// from destructors that run after a thread's buffer is gone goes through a
+// fallback buffer that hands off every record as soon as it is finished.
+//
+// example:
+// output::buffer() << "P1 = " << 1.5 << "\n";
+// output::buffer().point(x, y, z);
+// output::end_tick();
+// output::flush();
+
+namespace output {
+    enum class outmode {
+        text,
+        binary
+    };
+
+    // binary record layout (all fields little endian):
+    // line:   [u8 type][u32 length][length bytes]
+    // number: [u8 type][f64 value]
+    // point:  [u8 type][f64 x][f64 y][f64 z]
+    enum class recordtype : uint8_t {
+        line = 0x01,
+        number = 0x02,
+        point = 0x03
+    };
+
+    constexpr size_t chunk_size = 64 * 1024;
+    constexpr size_t ring_size = 16;
+    constexpr size_t batch_size = 64;
+    constexpr size_t line_header_size = 1 + sizeof(uint32_t);
+    constexpr std::chrono::milliseconds latency{5};
+
+    // same as the default std::ostream formatting (%g)
+    constexpr int float_precision = 6;
+
+    // pick the mode before anything is printed, switching mid line is not supported
+    inline std::atomic<outmode> current_mode{outmode::text};
+
+    inline void set_mode(outmode mode_) {
+        current_mode.store(mode_, std::memory_order_relaxed);
+    }
+
+    inline outmode mode() {
+        return current_mode.load(std::memory_order_relaxed);
+    }
+
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t capacity;
+        size_t size = 0;
+
+        Chunk(size_t capacity_ = chunk_size) : data(new char[capacity_]), capacity(capacity_) {}
+    };
+
+    // single producer / single consumer ring of chunk pointers
+    template<typename T, size_t N>
+    class SpscRing {
+        private:
+        std::array<T, N> slots{};
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+
+        public:
+        inline bool push(T value) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == N) {
+                return false;
+            }
+            slots[t % N] = value;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        inline bool pop(T &value) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            value = slots[h % N];
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        inline bool empty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+    };
+
+    // the link between one producing thread and the writer
+    struct Channel {
+        SpscRing<Chunk*, ring_size> full;
+        SpscRing<Chunk*, ring_size> spare;
+        std::atomic<uint64_t> submitted{0};
+        std::atomic<uint64_t> written{0};
+        std::atomic<bool> closed{false};
+
+        ~Channel() {
+            Chunk *chunk = nullptr;
+            while (full.pop(chunk)) delete chunk;
+            while (spare.pop(chunk)) delete chunk;
+        }
+    };
+
+    class Writer {
+        private:
+        int fd;
+        std::mutex channels_mutex;
+        std::vector<std::shared_ptr<Channel>> channels;
+        // work_bit: something was handed off, stop_bit: shutdown was requested
+        static constexpr uint32_t work_bit = 1;
+        static constexpr uint32_t stop_bit = 2;
+        std::atomic<uint32_t> pending{0};
+        std::atomic<bool> stopping{false};
+        std::atomic<bool> exited{false};
+        std::atomic<bool> finished{false};
+        std::mutex direct_mutex;
+        std::thread thread;
+
+        public:
+        Writer(int fd_ = 1) : fd(fd_) {
+            thread = std::thread([this] { run(); });
+        }
+
+        Writer(const Writer&) = delete;
+        Writer &operator=(const Writer&) = delete;
+
+        // drain everything handed off so far and stop the thread
+        inline void shutdown() {
+            if (stopping.exchange(true)) return;
+            pending.fetch_or(stop_bit, std::memory_order_release);
+            pending.notify_one();
+            thread.join();
+        }
+
+        inline std::shared_ptr<Channel> open_channel() {
+            std::shared_ptr<Channel> channel = std::make_shared<Channel>();
+            std::lock_guard<std::mutex> lock(channels_mutex);
+            channels.push_back(channel);
+            return channel;
+        }
+
+        // only the first handoff since the writer last woke up pays for the notify
+        inline void wake() {
+            if (pending.fetch_or(work_bit, std::memory_order_release) == 0) {
+                pending.notify_one();
+            }
+        }
+
+        inline bool has_exited() const {
+            return exited.load(std::memory_order_seq_cst);
+        }
+
+        // after the writer has exited, the producer owns its ring again
+        inline void wait_finished() {
+            finished.wait(false, std::memory_order_acquire);
+        }
+
+        inline void write_direct(const char *data, size_t size) {
+            std::lock_guard<std::mutex> lock(direct_mutex);
+            write_all(data, size);
+        }
+
+        private:
+        struct Pending {
+            Channel *channel;
+            Chunk *chunk;
+        };
+
+        void run() {
+            std::vector<std::shared_ptr<Channel>> snapshot;
+            std::vector<Pending> batch;
+            batch.reserve(batch_size);
+
+            while (true) {
+                drain(snapshot, batch);
+
+                // a handoff after the exchange sets pending again, so none is missed
+                pending.wait(0, std::memory_order_acquire);
+                if (pending.exchange(0, std::memory_order_acquire) & stop_bit) break;
+            }
+
+            // a producer that missed the flag has pushed before it, so this drain sees it;
+            // a producer that sees the flag waits for `finished` and drains its own ring
+            exited.store(true, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            drain(snapshot, batch);
+            finished.store(true, std::memory_order_release);
+            finished.notify_all();
+        }
+
+        inline void drain(std::vector<std::shared_ptr<Channel>> &snapshot, std::vector<Pending> &batch) {
+            {
+                std::lock_guard<std::mutex> lock(channels_mutex);
+                snapshot = channels;
+            }
+            for (std::shared_ptr<Channel> &channel : snapshot) {
+                Chunk *chunk = nullptr;
+                while (channel->full.pop(chunk)) {
+                    batch.push_back({channel.get(), chunk});
+                    if (batch.size() == batch_size) {
+                        write_batch(batch);
+                    }
+                }
+            }
+            if (!batch.empty()) {
+                write_batch(batch);
+            }
+            drop_closed();
+        }
+
+        inline void write_batch(std::vector<Pending> &batch) {
+            {
+                std::lock_guard<std::mutex> lock(direct_mutex);
+#ifdef _WIN32
+                for (Pending &pending : batch) {
+                    write_all(pending.chunk->data.get(), pending.chunk->size);
+                }
+#else
+                std::array<iovec, batch_size> iov;
+                size_t count = 0;
+                for (Pending &pending : batch) {
+                    if (pending.chunk->size == 0) continue;
+                    iov[count].iov_base = pending.chunk->data.get();
+                    iov[count].iov_len = pending.chunk->size;
+                    count++;
+                }
+                writev_all(iov.data(), count);
+#endif
+            }
+            for (Pending &pending : batch) {
+                pending.chunk->size = 0;
+                if (pending.chunk->capacity != chunk_size || !pending.channel->spare.push(pending.chunk)) {
+                    delete pending.chunk;
+                }
+                pending.channel->written.fetch_add(1, std::memory_order_release);
+                pending.channel->written.notify_all();
+            }
+            batch.clear();
+        }
+
+#ifdef _WIN32
+        inline void write_all(const char *data, size_t size) {
+            while (size > 0) {
+                int n = _write(fd, data, static_cast<unsigned int>(size));
+                if (n <= 0) return;
+                data += n;
+                size -= n;
+            }
+        }
+#else
+        inline void write_all(const char *data, size_t size) {
+            while (size > 0) {
+                ssize_t n = ::write(fd, data, size);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    return;
+                }
+                data += n;
+                size -= static_cast<size_t>(n);
+            }
+        }
+
+        inline void writev_all(iovec *iov, size_t count) {
+            while (count > 0) {
+                ssize_t n = ::writev(fd, iov, static_cast<int>(count));
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    return;
+                }
+                // skip the buffers that went out completely, then trim the partial one
+                size_t left = static_cast<size_t>(n);
+                while (count > 0 && left >= iov->iov_len) {
+                    left -= iov->iov_len;
+                    iov++;
+                    count--;
+                }
+                if (count > 0) {
+                    iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+                    iov->iov_len -= left;
+                }
+            }
+        }
+#endif
+
+        inline void drop_closed() {
+            std::lock_guard<std::mutex> lock(channels_mutex);
+            std::erase_if(channels, [](const std::shared_ptr<Channel> &channel) {
+                return channel->closed.load(std::memory_order_acquire) && channel->full.empty();
+            });
+        }
+    };
+
+    // never destroyed, so output from static destructors still has somewhere to go
+    inline Writer &writer() {
+        static Writer *instance = [] {
+            Writer *created = new Writer();
+            std::atexit([] { writer().shutdown(); });
+            return created;
+        }();
+        return *instance;
+    }
+
+    template<typename T>
+    constexpr bool is_char_v = std::is_same_v<T, char> || std::is_same_v<T, signed char> || std::is_same_v<T, unsigned char>
+        || std::is_same_v<T, wchar_t> || std::is_same_v<T, char8_t> || std::is_same_v<T, char16_t> || std::is_same_v<T, char32_t>;
+
+    // set once the calling thread's buffer has been destroyed at thread exit
+    inline thread_local bool buffer_destroyed = false;
+
+    class Buffer {
+        private:
+        Writer &target;
+        std::shared_ptr<Channel> channel;
+        Chunk *chunk;
+        size_t committed = 0;
+        bool line_open = false;
+        bool immediate = false;
+        std::chrono::steady_clock::time_point last_handoff{};
+
+        public:
+        Buffer(bool immediate_ = false) : target(writer()), channel(target.open_channel()), chunk(new Chunk()), immediate(immediate_) {}
+
+        ~Buffer() {
+            // an unterminated line goes out as written, without an added newline
+            if (line_open) {
+                if (mode() == outmode::binary) close_line();
+                line_open = false;
+                committed = chunk->size;
+            }
+            submit();
+            delete chunk;
+            channel->closed.store(true, std::memory_order_release);
+            if (!target.has_exited()) target.wake();
+            buffer_destroyed = true;
+        }
+
+        Buffer(const Buffer&) = delete;
+        Buffer &operator=(const Buffer&) = delete;
+
+        inline Buffer &operator<<(std::string_view str) {
+            // newlines end the current record so chunks are only split between lines
+            size_t start = 0;
+            size_t newline = str.find('\n');
+            while (newline != std::string_view::npos) {
+                append_text(str.substr(start, newline - start));
+                end_line();
+                start = newline + 1;
+                newline = str.find('\n', start);
+            }
+            append_text(str.substr(start));
+            return *this;
+        }
+
+        inline Buffer &operator<<(const std::string &str) {
+            return *this << std::string_view(str);
+        }
+
+        inline Buffer &operator<<(const char *str) {
+            return *this << std::string_view(str);
+        }
+
+        inline Buffer &operator<<(char c) {
+            if (c == '\n') {
+                end_line();
+            } else {
+                append_text(std::string_view(&c, 1));
+            }
+            return *this;
+        }
+
+        inline Buffer &operator<<(signed char c) {
+            return *this << static_cast<char>(c);
+        }
+
+        inline Buffer &operator<<(unsigned char c) {
+            return *this << static_cast<char>(c);
+        }
+
+        // not printable on a narrow stream, same as std::ostream
+        Buffer &operator<<(wchar_t) = delete;
+        Buffer &operator<<(char8_t) = delete;
+        Buffer &operator<<(char16_t) = delete;
+        Buffer &operator<<(char32_t) = delete;
+
+        // any other object pointer would convert to bool; print the address in hex like std::ostream
+        inline Buffer &operator<<(const void *ptr) {
+            std::uintptr_t address = reinterpret_cast<std::uintptr_t>(ptr);
+            if (address == 0) {
+                return *this << '0';
+            }
+            char digits[2 + 2 * sizeof(address)] = {'0', 'x'};
+            std::to_chars_result res = std::to_chars(digits + 2, digits + sizeof(digits), address, 16);
+            append_text(std::string_view(digits, res.ptr - digits));
+            return *this;
+        }
+
+        inline Buffer &operator<<(std::nullptr_t) {
+            return *this << std::string_view("nullptr");
+        }
+
+        inline Buffer &operator<<(bool value) {
+            return *this << (value ? '1' : '0');
+        }
+
+        template<typename T>
+        requires (std::is_integral_v<T> && !is_char_v<T> && !std::is_same_v<T, bool>)
+        inline Buffer &operator<<(T value) {
+            char digits[32];
+            std::to_chars_result res = std::to_chars(digits, digits + sizeof(digits), value);
+            append_text(std::string_view(digits, res.ptr - digits));
+            return *this;
+        }
+
+        template<typename T>
+        requires std::is_floating_point_v<T>
+        inline Buffer &operator<<(T value) {
+            char digits[64];
+            std::to_chars_result res = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, float_precision);
+            append_text(std::string_view(digits, res.ptr - digits));
+            return *this;
+        }
+
+        // finish the current line; a blank line is an empty record in binary mode
+        inline void end_line() {
+            if (mode() == outmode::binary) {
+                if (!line_open) open_line(0);
+                close_line();
+            } else {
+                reserve(1);
+                chunk->data[chunk->size++] = '\n';
+                line_open = false;
+            }
+            commit_record();
+        }
+
+        // a single number; "<value>\n" in text mode
+        inline void number(double value) {
+            if (mode() == outmode::binary) {
+                if (line_open) close_line();
+                reserve(1 + sizeof(uint64_t));
+                put_type(recordtype::number);
+                put_f64(value);
+                commit_record();
+            } else {
+                *this << value;
+                end_line();
+            }
+        }
+
+        // a point in space; "[x, y, z]\n" in text mode
+        inline void point(double x, double y, double z) {
+            if (mode() == outmode::binary) {
+                if (line_open) close_line();
+                reserve(1 + 3 * sizeof(uint64_t));
+                put_type(recordtype::point);
+                put_f64(x);
+                put_f64(y);
+                put_f64(z);
+                commit_record();
+            } else {
+                *this << '[' << x << ", " << y << ", " << z << ']';
+                end_line();
+            }
+        }
+
+        // hand every finished record to the writer without waiting
+        inline void end_tick() {
+            submit();
+        }
+
+        // hand every finished record to the writer and wait until it is out
+        inline void flush() {
+            submit();
+            uint64_t target_count = channel->submitted.load(std::memory_order_relaxed);
+            uint64_t done = channel->written.load(std::memory_order_acquire);
+            while (done < target_count) {
+                channel->written.wait(done, std::memory_order_acquire);
+                done = channel->written.load(std::memory_order_acquire);
+            }
+        }
+
+        private:
+        inline void append_text(std::string_view str) {
+            if (str.empty()) return;
+            if (mode() == outmode::binary && !line_open) {
+                open_line(str.size());
+            } else {
+                line_open = true;
+                reserve(str.size());
+            }
+            std::memcpy(chunk->data.get() + chunk->size, str.data(), str.size());
+            chunk->size += str.size();
+        }
+
+        inline void open_line(size_t n) {
+            reserve(line_header_size + n);
+            put_type(recordtype::line);
+            chunk->size += sizeof(uint32_t);
+            line_open = true;
+        }
+
+        // patch the length now that the whole line is known
+        inline void close_line() {
+            uint32_t length = static_cast<uint32_t>(chunk->size - committed - line_header_size);
+            store_le(chunk->data.get() + committed + 1, length);
+            line_open = false;
+            committed = chunk->size;
+        }
+
+        inline void commit_record() {
+            committed = chunk->size;
+            if (immediate || std::chrono::steady_clock::now() - last_handoff >= latency) {
+                submit();
+            }
+        }
+
+        // make room for n more bytes, moving the unfinished record to a fresh chunk if needed
+        inline void reserve(size_t n) {
+            if (chunk->size + n <= chunk->capacity) return;
+
+            size_t open = chunk->size - committed;
+            size_t needed = open + n;
+            if (needed > chunk_size) {
+                // grow oversized records geometrically so a long line is not copied on every append
+                needed = std::max(needed, 2 * chunk->capacity);
+            }
+            Chunk *next = take_spare(needed);
+            std::memcpy(next->data.get(), chunk->data.get() + committed, open);
+            next->size = open;
+            if (committed == 0) {
+                // a single record outgrew the chunk, nothing to hand off yet
+                delete chunk;
+            } else {
+                chunk->size = committed;
+                handoff(chunk);
+            }
+            chunk = next;
+            committed = 0;
+        }
+
+        inline void submit() {
+            if (committed == 0) return;
+            size_t open = chunk->size - committed;
+            Chunk *next = take_spare(open);
+            std::memcpy(next->data.get(), chunk->data.get() + committed, open);
+            next->size = open;
+            chunk->size = committed;
+            handoff(chunk);
+            chunk = next;
+            committed = 0;
+        }
+
+        inline Chunk *take_spare(size_t needed) {
+            if (needed > chunk_size) {
+                return new Chunk(needed);
+            }
+            Chunk *spare = nullptr;
+            if (channel->spare.pop(spare)) {
+                return spare;
+            }
+            return new Chunk();
+        }
+
+        inline void handoff(Chunk *full) {
+            last_handoff = std::chrono::steady_clock::now();
+            channel->submitted.fetch_add(1, std::memory_order_relaxed);
+            if (target.has_exited()) {
+                // the writer is gone, write it ourselves
+                target.wait_finished();
+                drain_own();
+                write_own(full);
+                return;
+            }
+
+            while (!channel->full.push(full)) {
+                // the writer is behind; give it a chance to catch up
+                if (target.has_exited()) {
+                    target.wait_finished();
+                    drain_own();
+                } else {
+                    target.wake();
+                    std::this_thread::yield();
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (target.has_exited()) {
+                target.wait_finished();
+                drain_own();
+            } else {
+                target.wake();
+            }
+        }
+
+        inline void drain_own() {
+            Chunk *full = nullptr;
+            while (channel->full.pop(full)) {
+                write_own(full);
+            }
+        }
+
+        inline void write_own(Chunk *full) {
+            target.write_direct(full->data.get(), full->size);
+            delete full;
+            channel->written.fetch_add(1, std::memory_order_release);
+        }
+
+        inline void put_type(recordtype type) {
+            chunk->data[chunk->size++] = static_cast<char>(type);
+        }
+
+        inline void put_f64(double value) {
+            store_le(chunk->data.get() + chunk->size, std::bit_cast<uint64_t>(value));
+            chunk->size += sizeof(uint64_t);
+        }
+
+        template<typename T>
+        static inline void store_le(char *dest, T value) {
+            for (size_t i = 0; i < sizeof(T); i++) {
+                dest[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+            }
+        }
+    };
+
+    // the calling thread's buffer
+    inline Buffer &buffer() {
+        if (buffer_destroyed) {
+            // printing from a destructor that runs after this thread's buffer is gone;
+            // never destroyed, so every record is handed off as soon as it is finished
+            thread_local Buffer *late = new Buffer(true);
+            return *late;
+        }
+        thread_local Buffer instance;
+        return instance;
+    }
+
+    // for the interpreter to call at the end of every tick and before blocking on input
+    inline void end_tick() {
+        buffer().end_tick();
+    }
+
+    inline void flush() {
+        buffer().flush();
+    }
+}
@@ -18,7 +18,7 @@ class Position {
     Position(int x = 0) {}
     Position(std::string fileTxt_, int idx_) : fileTxt(fileTxt_), idx(idx_) {}
 
-    bool operator==(const Position& other) {
+    bool operator==(const Position& other) const {
         return line == other.line && col == other.col && idx == other.idx;
     }
 
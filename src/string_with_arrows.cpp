@@ -1,5 +1,7 @@
 #include <iostream>
+#pragma once
 #include "position.cpp"
+#include "token.cpp"
 
 
 namespace pre_str {
@@ -12,6 +14,8 @@ namespace pre_str {
     }
 }
 
+inline std::string string_with_arrows(std::string str, Position start, Position end);
+
 inline std::string token_arrows(std::string str, Token_ token) {
     return string_with_arrows(str, token.posStart, token.posEnd);
 }
@@ -34,7 +38,7 @@ inline std::string string_with_arrows(std::string str, Position start, Position
     // between lines
     // end lines
 
-    int start_line_idx;
+    int start_line_idx = 0;
     while (i < str.size()) {
         if (str[i] == '\n') {
             line++;
@@ -45,7 +49,7 @@ inline std::string string_with_arrows(std::string str, Position start, Position
         }
         if (line == start.line && line == end.line) {
             int next_line_idx = i + 1;
-            while (str[next_line_idx] != '\n') {
+            while (next_line_idx < str.size() && str[next_line_idx] != '\n') {
                 next_line_idx++;
             }
             result += str.substr(start_line_idx, next_line_idx - start_line_idx);
@@ -55,7 +59,7 @@ inline std::string string_with_arrows(std::string str, Position start, Position
         }
         if (line == start.line && end.line != start.line) {
             int next_line_idx = i + 1;
-            while (str[next_line_idx] != '\n') {
+            while (next_line_idx < str.size() && str[next_line_idx] != '\n') {
                 next_line_idx++;
             }
             result += str.substr(start_line_idx, next_line_idx - start_line_idx);
@@ -65,7 +69,7 @@ inline std::string string_with_arrows(std::string str, Position start, Position
         }
         else if (line > start.line && line < end.line && col == 0) {
             int next_line_idx = i + 1;
-            while (str[next_line_idx] != '\n') {
+            while (next_line_idx < str.size() && str[next_line_idx] != '\n') {
                 next_line_idx++;
             }
             result += str.substr(start_line_idx, next_line_idx - start_line_idx);
@@ -75,7 +79,7 @@ inline std::string string_with_arrows(std::string str, Position start, Position
         }
         else if (line == end.line && line != start.line) {
             int next_line_idx = i + 1;
-            while (str[next_line_idx] != '\n') {
+            while (next_line_idx < str.size() && str[next_line_idx] != '\n') {
                 next_line_idx++;
             }
             int end_idx = start_line_idx + end.col;
@@ -1,4 +1,5 @@
 #include <iostream>
+#pragma once
 #include <vector>
 #include <array>
 #include <string>
@@ -0,0 +1,229 @@
+#include "../src/error.cpp"
+#include <cstdio>
+#include <sstream>
+#include <fcntl.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// stdout is redirected to a scratch file, every test reads back what reached it
+
+static int failures = 0;
+static std::string capture_path;
+static size_t capture_offset = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+// everything written to stdout since the last call
+static std::string take_output() {
+    FILE *file = std::fopen(capture_path.c_str(), "rb");
+    std::fseek(file, static_cast<long>(capture_offset), SEEK_SET);
+    std::string result;
+    char buf[4096];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), file)) > 0) {
+        result.append(buf, n);
+    }
+    std::fclose(file);
+    capture_offset += result.size();
+    return result;
+}
+
+// wait for output that is not flushed explicitly
+static std::string wait_output(size_t size) {
+    std::string result;
+    for (int i = 0; i < 2000 && result.size() < size; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        result += take_output();
+    }
+    return result;
+}
+
+template<typename T>
+concept printable = requires (output::Buffer &b, T value) { b << value; };
+
+static void test_formatting() {
+    output::Buffer &out = output::buffer();
+    out << 1.23456789 << ' ' << 1e20 << ' ' << 0.5f << ' ' << -7 << ' ' << 18446744073709551615ull << ' '
+        << static_cast<signed char>('A') << static_cast<unsigned char>('B') << ' ' << true << false << "\n";
+    output::flush();
+    CHECK(take_output() == "1.23457 1e+20 0.5 -7 18446744073709551615 AB 10\n");
+
+    int value = 0;
+    const void *null_ptr = nullptr;
+    std::ostringstream pointers;
+    pointers << &value << ' ' << null_ptr << ' ' << nullptr << "\n";
+    out << &value << ' ' << null_ptr << ' ' << nullptr << "\n";
+    output::flush();
+    CHECK(take_output() == pointers.str());
+
+    static_assert(!printable<wchar_t>);
+    static_assert(!printable<char8_t>);
+}
+
+static void test_flush() {
+    ErrorIllegalChar(Position(), "'$'").display();
+    // display() flushes, so the diagnostic is already in the file
+    CHECK(take_output() == "ILLEGAL CHARACTER: '$' AT LINE: 0 COLUMN: 0\n");
+
+    std::string src = "x = 1;\ny = $;\n";
+    Position start(src, 11);
+    Position end(src, 12);
+    start.line = end.line = 1;
+    start.col = 5;
+    end.col = 6;
+    ErrorSyntax(Token_(start, end, toktype::name, "$"), "expected expression").display();
+    CHECK(take_output() == "ERROR OCCURED AT LINE: 1 COLUMN: 5\ny = $;\n    ^\nSYNTAX ERROR: expected expression\n");
+
+    output::buffer() << "a\n" << "partial";
+    output::flush();
+    CHECK(take_output() == "a\n");
+    output::buffer() << " line\n";
+    output::flush();
+    CHECK(take_output() == "partial line\n");
+}
+
+static void test_latency() {
+    std::this_thread::sleep_for(output::latency * 2);
+    // the first line after a quiet period goes out without a flush
+    output::buffer() << "first\n";
+    CHECK(wait_output(6) == "first\n");
+
+    output::buffer() << "second\n";
+    output::end_tick();
+    CHECK(wait_output(7) == "second\n");
+}
+
+static void test_chunk_boundaries() {
+    std::string expected;
+    output::Buffer &out = output::buffer();
+    // lines that straddle chunk boundaries, then records larger than a chunk
+    for (int i = 0; i < 500; i++) {
+        std::string line = std::to_string(i) + ":" + std::string(997, 'a' + i % 26);
+        out << line << "\n";
+        expected += line + "\n";
+    }
+    for (size_t size : {output::chunk_size - 1, output::chunk_size, output::chunk_size * 3 + 7}) {
+        std::string line(size, 'z');
+        out << "big " << line << "\n";
+        expected += "big " + line + "\n";
+    }
+    out << "end\n";
+    expected += "end\n";
+    output::flush();
+    CHECK(take_output() == expected);
+}
+
+static void test_long_line() {
+    // a line many chunks long, built from small pieces, must not be copied on every append
+    const int pieces = 200000;
+    std::string expected;
+    output::Buffer &out = output::buffer();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < pieces; i++) {
+        out << "[" << i % 10 << ", 1.5] ";
+    }
+    out << "\n";
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    output::flush();
+
+    for (int i = 0; i < pieces; i++) {
+        expected += "[" + std::to_string(i % 10) + ", 1.5] ";
+    }
+    expected += "\n";
+    CHECK(take_output() == expected);
+    CHECK(seconds < 1.0);
+}
+
+static void test_thread_order() {
+    const int threads = 4;
+    const int lines = 50000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([t] {
+            output::Buffer &out = output::buffer();
+            for (int i = 0; i < lines; i++) {
+                out << "t" << t << " " << i << "\n";
+            }
+            output::flush();
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    std::string result = take_output();
+    std::vector<int> next(threads, 0);
+    size_t start = 0;
+    bool in_order = true;
+    while (start < result.size()) {
+        size_t end = result.find('\n', start);
+        int t = 0;
+        int i = 0;
+        if (end == std::string::npos || std::sscanf(result.c_str() + start, "t%d %d", &t, &i) != 2 || t < 0 || t >= threads || next[t] != i) {
+            in_order = false;
+            break;
+        }
+        next[t]++;
+        start = end + 1;
+    }
+    CHECK(in_order);
+    for (int t = 0; t < threads; t++) {
+        CHECK(next[t] == lines);
+    }
+}
+
+static void test_binary_layout() {
+    output::set_mode(output::outmode::binary);
+    output::Buffer &out = output::buffer();
+    out << "ab\n" << "\n";
+    out.number(1.5);
+    out << "c";
+    out.point(1.0, -2.0, 0.25);
+    output::flush();
+    output::set_mode(output::outmode::text);
+
+    const unsigned char expected[] = {
+        0x01, 0x02, 0x00, 0x00, 0x00, 'a', 'b',
+        0x01, 0x00, 0x00, 0x00, 0x00,
+        0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf8, 0x3f,
+        0x01, 0x01, 0x00, 0x00, 0x00, 'c',
+        0x03,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x3f,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0x3f,
+    };
+    CHECK(take_output() == std::string(reinterpret_cast<const char*>(expected), sizeof(expected)));
+}
+
+int main() {
+    char path[] = "/tmp/zetriscript_output_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        std::perror("mkstemp");
+        return 1;
+    }
+    capture_path = path;
+    dup2(fd, 1);
+    close(fd);
+
+    test_formatting();
+    test_flush();
+    test_latency();
+    test_chunk_boundaries();
+    test_long_line();
+    test_thread_order();
+    test_binary_layout();
+
+    std::remove(capture_path.c_str());
+    if (failures == 0) {
+        std::fprintf(stderr, "output tests passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}